@@ -3,8 +3,29 @@
 #include <ctime>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <cerrno>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
 using namespace std;
 
+// Template for the per-process directory where evicted (cold) files are kept as segment files.
+static const char *SEGMENT_DIR_TEMPLATE = "tfs_segments.XXXXXX";
+
+// Evicted files are appended to the current segment until it reaches this size.
+static const long long SEGMENT_LIMIT = 64LL * 1024 * 1024;
+
+// Ranged READ output and binary payload input move in chunks of this many bytes.
+static const size_t IO_CHUNK = 64 * 1024;
+
 template <typename T>
 static void reverse(vector<T> &p)
 {
@@ -20,11 +41,44 @@ static void reverse(vector<T> &p)
     }
 }
 
+// Fingerprint : 128-bit hash of a version's content. Built byte by byte, so
+// appending to the content only needs to extend the existing state.
+struct Fingerprint
+{
+    unsigned long long lo;
+    unsigned long long hi;
+
+    Fingerprint() : lo(14695981039346656037ULL), hi(0x6c62272e07bb0142ULL) {}
+
+    void extend(const string &data)
+    {
+        unsigned long long a = lo, b = hi;
+        for (unsigned char c : data)
+        {
+            a = (a ^ c) * 1099511628211ULL;
+            b = (b ^ c) * 0x9E3779B97F4A7C15ULL;
+            b ^= b >> 29;
+        }
+        lo = a;
+        hi = b;
+    }
+
+    bool operator==(const Fingerprint &other) const { return lo == other.lo && hi == other.hi; }
+};
+
+static Fingerprint fingerprintOf(const string &data)
+{
+    Fingerprint fp;
+    fp.extend(data);
+    return fp;
+}
+
 // TreeNode represents a version of a file .
 struct TreeNode
 {
     int version_id;
     string content;
+    Fingerprint fingerprint; // always matches content
     string message; // empty if not a snapshot.
     TreeNode *parent;
     vector<TreeNode *> children; // multiple branches possible
@@ -33,12 +87,19 @@ struct TreeNode
     TreeNode(int id, string data, string msg = "")
     {
         version_id = id;
-        content = data;
+        content.swap(data);
+        fingerprint = fingerprintOf(content);
         parent = nullptr;
         message = msg;
         created_timestamp = time(nullptr);
         snapshot_timestamp = 0;
     }
+    // For callers that already hashed `data`.
+    TreeNode(int id, string data, const Fingerprint &fp) : TreeNode(id, "")
+    {
+        content.swap(data);
+        fingerprint = fp;
+    }
 };
 
 // ---------------- HASHMAP ----------------
@@ -148,6 +209,39 @@ private:
     TreeNode *active_version;
     int total_versions;
     HashMap versionMap;
+    size_t resident_bytes; // approximate memory held by the version tree
+
+    static void writeString(ostream &out, const string &s)
+    {
+        size_t len = s.size();
+        out.write((const char *)&len, sizeof(len));
+        out.write(s.data(), len);
+    }
+
+    // The length comes from disk, so the string only grows as bytes are
+    // actually read; a damaged length fails at end of stream instead of
+    // allocating whatever it claims.
+    static bool readString(istream &in, string &s)
+    {
+        size_t len = 0;
+        if (!in.read((char *)&len, sizeof(len)))
+            return false;
+        s.clear();
+        while (s.size() < len)
+        {
+            size_t old = s.size();
+            size_t n = min(IO_CHUNK, len - old);
+            s.resize(old + n);
+            if (!in.read(&s[old], n))
+                return false;
+        }
+        return true;
+    }
+
+    static size_t nodeBytes(TreeNode *node)
+    {
+        return sizeof(TreeNode) + node->content.size() + node->message.size();
+    }
 
 public:
     File()
@@ -157,6 +251,7 @@ public:
         active_version = root;
         versionMap.insert(root->version_id, root);
         active_version->snapshot_timestamp = time(nullptr);
+        resident_bytes = nodeBytes(root);
     };
 
     ~File()
@@ -184,7 +279,23 @@ public:
             cout << active_version->content;
     }
 
-    void Insert(string newContent)
+    // Writes up to `len` bytes starting at `offset` straight from the stored content.
+    bool ReadRange(size_t offset, size_t len)
+    {
+        if (!active_version || offset > active_version->content.size())
+            return false;
+        const string &data = active_version->content;
+        size_t end = offset + min(len, data.size() - offset);
+        while (offset < end)
+        {
+            size_t n = min(IO_CHUNK, end - offset);
+            cout.write(data.data() + offset, n);
+            offset += n;
+        }
+        return true;
+    }
+
+    void Insert(const string &newContent)
     {
         if (!active_version)
             return;
@@ -197,34 +308,54 @@ public:
             active_version = newNode;
             versionMap.insert(newNode->version_id, newNode);
             active_version->created_timestamp = time(nullptr);
+            resident_bytes += nodeBytes(newNode);
         }
         else
+        {
             active_version->content += newContent;
+            active_version->fingerprint.extend(newContent);
+            resident_bytes += newContent.size();
+        }
     }
 
-    void Update(string newContent)
+    // Returns false if nothing changed because skip_identical is set and the
+    // new content matches the active version.
+    bool Update(const string &newContent, bool skip_identical = false)
     {
         if (!active_version)
-            return;
+            return false;
+        Fingerprint fp = fingerprintOf(newContent);
+        if (skip_identical && active_version->content.size() == newContent.size() &&
+            active_version->fingerprint == fp)
+            return false;
         if (active_version->snapshot_timestamp != 0)
         {
             total_versions++;
-            TreeNode *newNode = new TreeNode(total_versions - 1, newContent);
+            TreeNode *newNode = new TreeNode(total_versions - 1, newContent, fp);
             newNode->parent = active_version;
             active_version->children.push_back(newNode);
             active_version = newNode;
             versionMap.insert(newNode->version_id, newNode);
             active_version->created_timestamp = time(nullptr);
+            resident_bytes += nodeBytes(newNode);
         }
         else
+        {
+            resident_bytes -= active_version->content.size();
             active_version->content = newContent;
+            active_version->fingerprint = fp;
+            resident_bytes += newContent.size();
+        }
+        return true;
     }
 
     void Snapshot(const string &snapshot_msg)
     {
         if (active_version->snapshot_timestamp == 0)
         {
+            resident_bytes -= active_version->message.size();
             active_version->message = snapshot_msg;
+            resident_bytes += snapshot_msg.size();
             active_version->snapshot_timestamp = time(nullptr);
         }
     }
@@ -281,7 +412,111 @@ public:
         cout << "------------------------------------------" << endl;
     }
 
+    // 1 if both versions hold the same content, 0 if not, -1 if either version is missing.
+    int Equals(int v1, int v2)
+    {
+        TreeNode *a = versionMap.Search(v1);
+        TreeNode *b = versionMap.Search(v2);
+        if (!a || !b)
+            return -1;
+        return a->content.size() == b->content.size() && a->fingerprint == b->fingerprint;
+    }
+
+    // Recomputes every version's fingerprint; returns the number of mismatches.
+    int Verify(int &checked)
+    {
+        int corrupted = 0;
+        checked = 0;
+        vector<TreeNode *> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            TreeNode *node = stack.back();
+            stack.pop_back();
+            checked++;
+            if (!(fingerprintOf(node->content) == node->fingerprint))
+            {
+                cout << "Version " << node->version_id << " failed integrity check!" << endl;
+                corrupted++;
+            }
+            for (TreeNode *child : node->children)
+                stack.push_back(child);
+        }
+        return corrupted;
+    }
+
     TreeNode *getActiveVersion() { return active_version; }
+
+    size_t MemoryUsage() { return resident_bytes; }
+
+    // Writes the whole version tree in pre-order, so every parent precedes its children.
+    void Save(ostream &out)
+    {
+        out.write((const char *)&total_versions, sizeof(total_versions));
+        out.write((const char *)&active_version->version_id, sizeof(int));
+        vector<TreeNode *> stack;
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            TreeNode *node = stack.back();
+            stack.pop_back();
+            int parent_id = node->parent ? node->parent->version_id : -1;
+            out.write((const char *)&node->version_id, sizeof(int));
+            out.write((const char *)&parent_id, sizeof(int));
+            out.write((const char *)&node->created_timestamp, sizeof(time_t));
+            out.write((const char *)&node->snapshot_timestamp, sizeof(time_t));
+            writeString(out, node->content);
+            out.write((const char *)&node->fingerprint, sizeof(Fingerprint));
+            writeString(out, node->message);
+            for (int i = (int)node->children.size() - 1; i >= 0; i--)
+                stack.push_back(node->children[i]);
+        }
+    }
+
+    // Rebuilds the tree written by Save() into a freshly constructed File.
+    bool Load(istream &in)
+    {
+        int count = 0, active_id = 0;
+        if (!in.read((char *)&count, sizeof(count)) || !in.read((char *)&active_id, sizeof(active_id)))
+            return false;
+        resident_bytes = 0;
+        for (int i = 0; i < count; i++)
+        {
+            int id, parent_id;
+            time_t created, snapshot;
+            string data, msg;
+            Fingerprint fp;
+            if (!in.read((char *)&id, sizeof(int)) || !in.read((char *)&parent_id, sizeof(int)) ||
+                !in.read((char *)&created, sizeof(time_t)) || !in.read((char *)&snapshot, sizeof(time_t)) ||
+                !readString(in, data) || !in.read((char *)&fp, sizeof(Fingerprint)) || !readString(in, msg))
+                return false;
+            TreeNode *node = root;
+            if (parent_id != -1)
+            {
+                TreeNode *parent = versionMap.Search(parent_id);
+                if (!parent)
+                    return false;
+                node = new TreeNode(id, "");
+                node->parent = parent;
+                parent->children.push_back(node);
+                versionMap.insert(id, node);
+            }
+            node->content.swap(data);
+            node->fingerprint = fp; // kept as stored so VERIFY can detect damaged segments
+            node->message.swap(msg);
+            node->created_timestamp = created;
+            node->snapshot_timestamp = snapshot;
+            resident_bytes += nodeBytes(node);
+        }
+        total_versions = count;
+        active_version = versionMap.Search(active_id);
+        if (!active_version)
+        {
+            active_version = root;
+            return false;
+        }
+        return true;
+    }
 };
 
 struct HeapNode
@@ -291,9 +526,15 @@ struct HeapNode
     long long update_counter; // replaces timestamp
     int total_versions;
     int index;
+    long long segment_id; // -1 while resident, otherwise the segment holding the evicted file
+    long long segment_offset;
+    HeapNode *lru_prev;   // neighbours in FileSystem's access-ordered list of resident files
+    HeapNode *lru_next;
+    bool in_batch;        // set while a COMMIT is collecting the files it touches
 
     HeapNode(const string &fname, File *fptr, long long counter, int idx, int versions = 1)
-        : file_name(fname), filePtr(fptr), update_counter(counter), total_versions(versions), index(idx) {}
+        : file_name(fname), filePtr(fptr), update_counter(counter), total_versions(versions), index(idx), segment_id(-1),
+          segment_offset(0), lru_prev(nullptr), lru_next(nullptr), in_batch(false) {}
 };
 
 struct MapNode
@@ -308,19 +549,40 @@ class CustomMap
 {
 private:
     int capacity;
+    int count;
     vector<MapNode *> table;
     int hashFunction(const string &key)
     {
-        int sum = 0;
+        unsigned int h = 0;
         for (char c : key)
-            sum += c;
-        return sum % capacity;
+            h = h * 31 + (unsigned char)c;
+        return h % capacity;
+    }
+
+    // Doubles the bucket count once chains get long, so bulk imports stay O(1) per lookup.
+    void rehash()
+    {
+        vector<MapNode *> old = table;
+        capacity *= 2;
+        table.assign(capacity, nullptr);
+        for (MapNode *head : old)
+        {
+            while (head)
+            {
+                MapNode *next = head->next;
+                int idx = hashFunction(head->key);
+                head->next = table[idx];
+                table[idx] = head;
+                head = next;
+            }
+        }
     }
 
 public:
     CustomMap(int size = 100)
     {
         capacity = size;
+        count = 0;
         table.resize(capacity, nullptr);
     }
     void insert(const string &key, HeapNode *heapPtr)
@@ -328,7 +590,10 @@ public:
         int idx = hashFunction(key);
         MapNode *newNode = new MapNode(key, heapPtr);
         if (!table[idx])
+        {
             table[idx] = newNode;
+            count++;
+        }
         else
         {
             MapNode *temp = table[idx];
@@ -340,8 +605,13 @@ public:
                 delete newNode;
             }
             else
+            {
                 temp->next = newNode;
+                count++;
+            }
         }
+        if (count > 2 * capacity)
+            rehash();
     }
     HeapNode *get(const string &key)
     {
@@ -372,6 +642,7 @@ public:
         else
             last->next = temp->next;
         delete temp;
+        count--;
     }
 };
 
@@ -472,8 +743,60 @@ public:
         }
     }
 
+    // Like insertOrUpdate, but leaves the heap order alone; call rebuild() once
+    // after a batch of stage() calls.
+    HeapNode *stage(const string &file_name, File *fptr, int new_versions)
+    {
+        HeapNode *node = map.get(file_name);
+        global_counter++;
+        if (node)
+        {
+            node->update_counter = global_counter;
+            node->total_versions += new_versions;
+            node->filePtr = fptr;
+            return node;
+        }
+        HeapNode *newNode = new HeapNode(file_name, fptr, global_counter, heap.size(), new_versions);
+        heap.push_back(newNode);
+        map.insert(file_name, newNode);
+        return newNode;
+    }
+
+    // Restores the heap property over the whole array in O(n).
+    void rebuild()
+    {
+        for (int i = (int)heap.size() / 2 - 1; i >= 0; i--)
+            heapifyDown(i);
+    }
+
+    // Fixes the heap after stage() raised the counters of `nodes` only. Staged
+    // counters exceed every other counter, so sifting them up largest first is
+    // enough : a node that has already settled is never pushed below a smaller
+    // one. Falls back to a full rebuild when that is cheaper.
+    void fixup(vector<HeapNode *> nodes)
+    {
+        int n = heap.size();
+        int depth = 1;
+        while ((1 << depth) <= n)
+            depth++;
+        if ((long long)nodes.size() * depth > n)
+        {
+            rebuild();
+            return;
+        }
+        sort(nodes.begin(), nodes.end(), [](HeapNode *a, HeapNode *b)
+             { return a->update_counter > b->update_counter; });
+        for (HeapNode *node : nodes)
+            heapifyUp(node->index);
+    }
+
     HeapNode *getMax() { return heap.empty() ? nullptr : heap[0]; }
 
+    int size() { return heap.size(); }
+
+    HeapNode *at(int i) { return heap[i]; }
+
+
     void printHeap_recent(int num)
     {
         cout << " RECENT FILES (most recent first):\n";
@@ -558,6 +881,89 @@ public:
     }
 };
 
+// MappedFile : read-only mmap of a file on disk, unmapped on destruction.
+struct MappedFile
+{
+    const char *data;
+    size_t size;
+    bool ok;
+
+    MappedFile(const string &path) : data(nullptr), size(0), ok(false)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0)
+        {
+            size = st.st_size;
+            ok = true;
+            if (size > 0)
+            {
+                void *p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED)
+                    ok = false;
+                else
+                {
+                    data = (const char *)p;
+                    madvise(p, size, MADV_SEQUENTIAL);
+                }
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile()
+    {
+        if (data)
+            munmap((void *)data, size);
+    }
+};
+
+// LatencyReservoir : fixed-size uniform sample of latencies, so p99 can be
+// reported without keeping every measurement.
+struct LatencyReservoir
+{
+    static const size_t CAPACITY = 4096;
+    vector<long long> samples;
+    long long seen = 0;
+    unsigned long long rng = 0x2545F4914F6CDD1DULL;
+
+    void add(long long ns)
+    {
+        seen++;
+        if (samples.size() < CAPACITY)
+        {
+            samples.push_back(ns);
+            return;
+        }
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        unsigned long long slot = rng % (unsigned long long)seen;
+        if (slot < CAPACITY)
+            samples[slot] = ns;
+    }
+
+    long long p99()
+    {
+        if (samples.empty())
+            return 0;
+        vector<long long> sorted = samples;
+        sort(sorted.begin(), sorted.end());
+        return sorted[(sorted.size() * 99 + 99) / 100 - 1];
+    }
+};
+
+// StagedOp : an INSERT or UPDATE held back until the enclosing transaction commits.
+struct StagedOp
+{
+    bool is_update;
+    HeapNode *node;
+    string content;
+    StagedOp(bool upd, HeapNode *n, const string &data) : is_update(upd), node(n), content(data) {}
+};
+
 class FileSystem
 {
 
@@ -565,9 +971,272 @@ private:
     MaxHeap fileHeap;
     CustomMap fileMap;
 
+    // Tiered storage : once resident bytes exceed the budget, the least recently
+    // used files are written to segment files and faulted back in on access.
+    size_t memory_budget = 0; // 0 means unlimited
+    size_t resident_bytes = 0;
+    string segment_dir; // created on first eviction, private to this process
+    long long next_segment = 0;
+    ofstream segment_out;            // segment currently being appended to
+    long long segment_size = 0;
+    vector<long long> segment_live;  // evicted files still stored in each segment
+    HeapNode *lru_head = nullptr; // least recently used resident file
+    HeapNode *lru_tail = nullptr; // most recently used resident file
+    long long tier_hits = 0;
+    long long tier_misses = 0;
+
+    // Per-command latency, split by whether the command had to restore a file.
+    chrono::steady_clock::time_point command_start;
+    bool command_touched = false;
+    bool command_cold = false;
+    LatencyReservoir hot_latency_ns;
+    LatencyReservoir cold_latency_ns;
+
+    bool elide_noop_updates = false; // skip UPDATEs whose content matches the active version
+
+    // BEGIN/COMMIT : INSERTs and UPDATEs are staged and applied together on commit.
+    bool in_transaction = false;
+    bool transaction_failed = false;
+    vector<StagedOp> staged;
+
+    // Stages an operation; returns false if no transaction is open.
+    bool stageOp(bool is_update, const string &filename, const string &content)
+    {
+        if (!in_transaction)
+            return false;
+        HeapNode *node = fileMap.get(filename);
+        if (!node)
+        {
+            cout << "File not found: " << filename << endl;
+            transaction_failed = true;
+            return true;
+        }
+        staged.push_back(StagedOp(is_update, node, content));
+        return true;
+    }
+
+    string segmentPath(long long id)
+    {
+        return segment_dir + "/seg_" + to_string(id) + ".bin";
+    }
+
+    void lruUnlink(HeapNode *node)
+    {
+        if (node->lru_prev)
+            node->lru_prev->lru_next = node->lru_next;
+        else
+            lru_head = node->lru_next;
+        if (node->lru_next)
+            node->lru_next->lru_prev = node->lru_prev;
+        else
+            lru_tail = node->lru_prev;
+        node->lru_prev = node->lru_next = nullptr;
+    }
+
+    void lruPushBack(HeapNode *node)
+    {
+        node->lru_prev = lru_tail;
+        node->lru_next = nullptr;
+        if (lru_tail)
+            lru_tail->lru_next = node;
+        else
+            lru_head = node;
+        lru_tail = node;
+    }
+
+    // Drops one stored file from segment `id`; a finished segment is deleted once nothing in it is live.
+    void releaseSegment(long long id)
+    {
+        segment_live[id]--;
+        if (segment_live[id] == 0 && id != next_segment - 1)
+            remove(segmentPath(id).c_str());
+    }
+
+    // Starts a new segment; the previous one is deleted if nothing in it is live.
+    bool rollSegment()
+    {
+        if (segment_dir.empty())
+        {
+            string dir = SEGMENT_DIR_TEMPLATE;
+            if (!mkdtemp(&dir[0]))
+                return false;
+            segment_dir = dir;
+        }
+        if (segment_out.is_open())
+        {
+            segment_out.close();
+            if (segment_live[next_segment - 1] == 0)
+                remove(segmentPath(next_segment - 1).c_str());
+        }
+        long long id = next_segment++;
+        segment_live.push_back(0);
+        segment_out.open(segmentPath(id), ios::binary | ios::trunc);
+        segment_size = 0;
+        return (bool)segment_out;
+    }
+
+    bool evict(HeapNode *node)
+    {
+        if ((!segment_out.is_open() || !segment_out || segment_size >= SEGMENT_LIMIT) && !rollSegment())
+            return false;
+        long long offset = segment_size;
+        node->filePtr->Save(segment_out);
+        segment_out.flush();
+        if (!segment_out)
+            return false;
+        segment_size = segment_out.tellp();
+        long long id = next_segment - 1;
+        segment_live[id]++;
+        resident_bytes -= node->filePtr->MemoryUsage();
+        delete node->filePtr;
+        node->filePtr = nullptr;
+        node->segment_id = id;
+        node->segment_offset = offset;
+        lruUnlink(node);
+        return true;
+    }
+
+    // Loads the copy of `node` stored in its segment into `file`.
+    bool readSegment(HeapNode *node, File *file)
+    {
+        ifstream in(segmentPath(node->segment_id), ios::binary);
+        return in && in.seekg(node->segment_offset) && file->Load(in);
+    }
+
+    // Evicts least recently used files until the budget holds again; `keep` is never evicted.
+    void enforceBudget(HeapNode *keep)
+    {
+        while (memory_budget != 0 && resident_bytes > memory_budget)
+        {
+            HeapNode *coldest = lru_head;
+            if (coldest == keep)
+                coldest = coldest->lru_next;
+            if (!coldest || !evict(coldest))
+                break;
+        }
+    }
+
+    // Returns the in-memory File for `node`, faulting it back in from its segment if needed.
+    File *fetch(HeapNode *node)
+    {
+        command_touched = true;
+        if (node->filePtr)
+        {
+            tier_hits++;
+            lruUnlink(node);
+            lruPushBack(node);
+            return node->filePtr;
+        }
+        File *file = new File();
+        if (!readSegment(node, file))
+        {
+            delete file;
+            cout << "Failed to restore file: " << node->file_name << endl;
+            return nullptr;
+        }
+        releaseSegment(node->segment_id);
+        node->filePtr = file;
+        node->segment_id = -1;
+        lruPushBack(node);
+        resident_bytes += file->MemoryUsage();
+        tier_misses++;
+        command_cold = true;
+        enforceBudget(node);
+        return file;
+    }
+
+    // Looks up a file and makes it resident, printing the usual error if it does not exist.
+    File *openFile(const string &filename, HeapNode *&node)
+    {
+        node = fileMap.get(filename);
+        if (!node)
+        {
+            cout << "File not found: " << filename << endl;
+            return nullptr;
+        }
+        return fetch(node);
+    }
+
+    // Creates or fetches `filename` for a bulk import; the heap is fixed up by the caller.
+    File *importTarget(const string &filename, HeapNode *&node, bool &created)
+    {
+        node = fileMap.get(filename);
+        created = !node;
+        if (node)
+            return fetch(node);
+        File *file = new File();
+        node = fileHeap.stage(filename, file, 1);
+        fileMap.insert(filename, node);
+        lruPushBack(node);
+        resident_bytes += file->MemoryUsage();
+        return file;
+    }
+
+    // Imports every regular file below `dir`, named by its path relative to the import root.
+    void importTree(const string &dir, const string &prefix, long long &files)
+    {
+        DIR *d = opendir(dir.c_str());
+        if (!d)
+        {
+            cout << "Cannot open directory: " << dir << endl;
+            return;
+        }
+        struct dirent *entry;
+        while ((entry = readdir(d)) != nullptr)
+        {
+            string name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+            string path = dir + "/" + name;
+            string fname = prefix.empty() ? name : prefix + "/" + name;
+            struct stat st;
+            if (lstat(path.c_str(), &st) != 0)
+                continue;
+            if (S_ISDIR(st.st_mode))
+            {
+                importTree(path, fname, files);
+                continue;
+            }
+            if (!S_ISREG(st.st_mode))
+                continue;
+            if (fileMap.get(fname))
+            {
+                cout << "File already exists: " << fname << endl;
+                continue;
+            }
+            MappedFile mf(path);
+            if (!mf.ok)
+            {
+                cout << "Cannot read file: " << path << endl;
+                continue;
+            }
+            bool created;
+            HeapNode *node;
+            File *file = importTarget(fname, node, created);
+            size_t before = file->MemoryUsage();
+            file->Update(string(mf.data ? mf.data : "", mf.size));
+            file->Snapshot("Imported");
+            resident_bytes += file->MemoryUsage() - before;
+            fileHeap.stage(fname, file, 1);
+            files++;
+            enforceBudget(node);
+        }
+        closedir(d);
+    }
+
 public:
     FileSystem() : fileMap(200) {}
 
+    ~FileSystem()
+    {
+        segment_out.close();
+        for (long long id = 0; id < next_segment; id++)
+            if (segment_live[id] != 0 || id == next_segment - 1)
+                remove(segmentPath(id).c_str());
+        if (!segment_dir.empty())
+            rmdir(segment_dir.c_str());
+    }
+
     void create(const string &filename)
     {
         if (fileMap.get(filename))
@@ -578,22 +1247,139 @@ public:
         File *newFile = new File();
         fileHeap.insertOrUpdate(filename, newFile);
         fileMap.insert(filename, fileHeap.getMax());
+        lruPushBack(fileHeap.getMax());
+        resident_bytes += newFile->MemoryUsage();
         cout << "File created: " << filename << endl;
+        enforceBudget(fileHeap.getMax());
     }
 
     void read(const string &filename)
     {
-        HeapNode *node = fileMap.get(filename);
-        if (!node)
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        file->Read();
+        cout << endl;
+    }
+
+    void readRange(const string &filename, size_t offset, size_t len)
+    {
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        if (!file->ReadRange(offset, len))
         {
-            cout << "File not found: " << filename << endl;
+            cout << "Offset " << offset << " is past the end of " << filename << endl;
             return;
         }
-        node->filePtr->Read();
         cout << endl;
     }
 
     void insert(const string &filename, const string &content)
+    {
+        if (stageOp(false, filename, content))
+            return;
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        size_t before = file->MemoryUsage();
+        file->Insert(content);
+        resident_bytes += file->MemoryUsage() - before;
+        fileHeap.insertOrUpdate(filename, file);
+        enforceBudget(node);
+    }
+
+    void update(const string &filename, const string &content)
+    {
+        if (stageOp(true, filename, content))
+            return;
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        size_t before = file->MemoryUsage();
+        if (!file->Update(content, elide_noop_updates))
+            return;
+        resident_bytes += file->MemoryUsage() - before;
+        fileHeap.insertOrUpdate(filename, file);
+        enforceBudget(node);
+    }
+
+    void snapshot(const string &filename, const string &message)
+    {
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        size_t before = file->MemoryUsage();
+        file->Snapshot(message);
+        resident_bytes += file->MemoryUsage() - before;
+        enforceBudget(node);
+        // fileHeap.insertOrUpdate(filename, node->filePtr);  //Not being counted as modification.
+    }
+
+    void rollback(const string &filename, int versionID = -1)
+    {
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        file->Rollback(versionID);
+       // fileHeap.insertOrUpdate(filename, node->filePtr);  //Not being counted as modification.
+    }
+
+    void history(const string &filename)
+    {
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        file->History();
+    }
+
+    void equals(const string &filename, int v1, int v2)
+    {
+        HeapNode *node;
+        File *file = openFile(filename, node);
+        if (!file)
+            return;
+        int result = file->Equals(v1, v2);
+        if (result == -1)
+            cout << "Version " << v1 << " or " << v2 << " not found!" << endl;
+        else if (result)
+            cout << "Versions " << v1 << " and " << v2 << " are identical" << endl;
+        else
+            cout << "Versions " << v1 << " and " << v2 << " differ" << endl;
+    }
+
+    // Evicted files are checked from a temporary copy of their segment, so
+    // verification neither counts as an access nor changes what is resident.
+    void verifyNode(HeapNode *node)
+    {
+        int checked = 0;
+        int corrupted = 0;
+        if (node->filePtr)
+            corrupted = node->filePtr->Verify(checked);
+        else
+        {
+            File *copy = new File();
+            if (!readSegment(node, copy))
+            {
+                delete copy;
+                cout << "Verified " << node->file_name << ": FAILED, segment is damaged and could not be read" << endl;
+                return;
+            }
+            corrupted = copy->Verify(checked);
+            delete copy;
+        }
+        cout << "Verified " << node->file_name << ": " << checked << " versions, "
+             << corrupted << " corrupted" << endl;
+    }
+
+    void verify(const string &filename)
     {
         HeapNode *node = fileMap.get(filename);
         if (!node)
@@ -601,59 +1387,254 @@ public:
             cout << "File not found: " << filename << endl;
             return;
         }
-        node->filePtr->Insert(content);
-        fileHeap.insertOrUpdate(filename, node->filePtr);
+        verifyNode(node);
     }
 
-    void update(const string &filename, const string &content)
+    void verifyAll()
     {
-        HeapNode *node = fileMap.get(filename);
-        if (!node)
+        for (int i = 0; i < fileHeap.size(); i++)
+            verifyNode(fileHeap.at(i));
+    }
+
+    void setElideNoopUpdates(bool on)
+    {
+        elide_noop_updates = on;
+        cout << "No-op update elision " << (on ? "enabled" : "disabled") << endl;
+    }
+
+    void importDirectory(const string &dir)
+    {
+        long long files = 0;
+        importTree(dir, "", files);
+        fileHeap.rebuild();
+        enforceBudget(nullptr);
+        cout << "Imported " << files << " files from " << dir << endl;
+    }
+
+    // Imports a revision stream made of the records
+    //   FILE <name>
+    //   DATA <length>\n<length raw bytes>
+    //   SNAPSHOT <message>
+    // where each DATA becomes a new revision of the current file.
+    void importStream(const string &path)
+    {
+        MappedFile mf(path);
+        if (!mf.ok)
         {
-            cout << "File not found: " << filename << endl;
+            cout << "Cannot read stream: " << path << endl;
             return;
         }
-        node->filePtr->Update(content);
-        fileHeap.insertOrUpdate(filename, node->filePtr);
+        const char *p = mf.data;
+        const char *end = mf.data + mf.size;
+        string current;
+        HeapNode *node = nullptr;
+        File *file = nullptr;
+        long long files = 0, revisions = 0;
+        while (p < end)
+        {
+            const char *eol = p;
+            while (eol < end && *eol != '\n')
+                eol++;
+            string line(p, eol);
+            p = eol < end ? eol + 1 : end;
+            if (line.empty())
+                continue;
+            if (line.compare(0, 5, "FILE ") == 0)
+            {
+                current = line.substr(5);
+                bool created;
+                file = importTarget(current, node, created);
+                if (created)
+                    files++;
+            }
+            else if (line.compare(0, 5, "DATA ") == 0 && file)
+            {
+                const char *digits = line.c_str() + 5;
+                char *digits_end;
+                errno = 0;
+                unsigned long long len = strtoull(digits, &digits_end, 10);
+                if (!isdigit((unsigned char)*digits) || *digits_end != '\0' || errno == ERANGE)
+                {
+                    cout << "Bad stream record: " << line << endl;
+                    break;
+                }
+                if (len > (unsigned long long)(end - p))
+                {
+                    cout << "Truncated stream: " << path << endl;
+                    break;
+                }
+                size_t before = file->MemoryUsage();
+                file->Update(string(p, len));
+                resident_bytes += file->MemoryUsage() - before;
+                fileHeap.stage(current, file, 1);
+                revisions++;
+                p += len;
+                if (p < end && *p == '\n')
+                    p++;
+                enforceBudget(node);
+            }
+            else if (line.compare(0, 9, "SNAPSHOT ") == 0 && file)
+            {
+                size_t before = file->MemoryUsage();
+                file->Snapshot(line.substr(9));
+                resident_bytes += file->MemoryUsage() - before;
+                enforceBudget(node);
+            }
+            else
+            {
+                cout << "Bad stream record: " << line << endl;
+                break;
+            }
+        }
+        fileHeap.rebuild();
+        enforceBudget(nullptr);
+        cout << "Imported " << revisions << " revisions (" << files << " new files) from " << path << endl;
     }
 
-    void snapshot(const string &filename, const string &message)
+    void begin()
     {
-        HeapNode *node = fileMap.get(filename);
-        if (!node)
+        if (in_transaction)
         {
-            cout << "File not found: " << filename << endl;
+            cout << "Transaction already in progress" << endl;
             return;
         }
-        node->filePtr->Snapshot(message);
-        // fileHeap.insertOrUpdate(filename, node->filePtr);  //Not being counted as modification.
+        in_transaction = true;
+        transaction_failed = false;
+        staged.clear();
+        cout << "Transaction started" << endl;
     }
 
-    void rollback(const string &filename, int versionID = -1)
+    void abort()
     {
-        HeapNode *node = fileMap.get(filename);
-        if (!node)
+        if (!in_transaction)
         {
-            cout << "File not found: " << filename << endl;
+            cout << "No transaction in progress" << endl;
             return;
         }
-        node->filePtr->Rollback(versionID);
-       // fileHeap.insertOrUpdate(filename, node->filePtr);  //Not being counted as modification.
+        in_transaction = false;
+        staged.clear();
+        cout << "Transaction aborted" << endl;
     }
 
-    void history(const string &filename)
+    // Applies every staged operation, snapshots each touched file with `message`
+    // and fixes the heap once for the whole batch.
+    void commit(const string &message)
     {
-        HeapNode *node = fileMap.get(filename);
-        if (!node)
+        if (!in_transaction)
         {
-            cout << "File not found: " << filename << endl;
+            cout << "No transaction in progress" << endl;
+            return;
+        }
+        if (transaction_failed)
+        {
+            abort();
+            return;
+        }
+
+        // Fault in every touched file before changing anything, with eviction
+        // paused so one restore cannot push out another.
+        size_t budget = memory_budget;
+        memory_budget = 0;
+        vector<HeapNode *> touched;
+        bool restored = true;
+        for (const StagedOp &op : staged)
+        {
+            if (op.node->in_batch)
+                continue;
+            op.node->in_batch = true;
+            touched.push_back(op.node);
+            if (!fetch(op.node))
+            {
+                restored = false;
+                break;
+            }
+        }
+        for (HeapNode *node : touched)
+            node->in_batch = false;
+        if (!restored)
+        {
+            memory_budget = budget;
+            abort();
             return;
         }
-        node->filePtr->History();
+
+        int applied = 0;
+        for (StagedOp &op : staged)
+        {
+            File *file = op.node->filePtr;
+            size_t before = file->MemoryUsage();
+            if (op.is_update)
+            {
+                if (!file->Update(op.content, elide_noop_updates))
+                    continue;
+            }
+            else
+                file->Insert(op.content);
+            resident_bytes += file->MemoryUsage() - before;
+            fileHeap.stage(op.node->file_name, file, 1);
+            applied++;
+        }
+        for (HeapNode *node : touched)
+        {
+            size_t before = node->filePtr->MemoryUsage();
+            node->filePtr->Snapshot(message);
+            resident_bytes += node->filePtr->MemoryUsage() - before;
+        }
+        fileHeap.fixup(touched);
+
+        in_transaction = false;
+        staged.clear();
+        memory_budget = budget;
+        enforceBudget(nullptr);
+        cout << "Committed " << applied << " changes across " << touched.size() << " files" << endl;
     }
+
     void printRecentFiles(int n) { fileHeap.printHeap_recent(n); }
 
     void printBiggestFiles(int n) { fileHeap.printHeap_biggest(n); }
+
+    // Brackets one input command so its latency can be attributed to hot or cold access.
+    void beginCommand()
+    {
+        command_touched = false;
+        command_cold = false;
+        command_start = chrono::steady_clock::now();
+    }
+
+    void endCommand()
+    {
+        if (!command_touched)
+            return;
+        long long ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - command_start).count();
+        if (command_cold)
+            cold_latency_ns.add(ns);
+        else
+            hot_latency_ns.add(ns);
+    }
+
+    void setMemoryBudget(size_t bytes)
+    {
+        memory_budget = bytes;
+        enforceBudget(nullptr);
+        cout << "Memory budget set to " << bytes << " bytes" << endl;
+    }
+
+    void printTierStats()
+    {
+        long long total = tier_hits + tier_misses;
+        int evicted = 0;
+        for (int i = 0; i < fileHeap.size(); i++)
+            if (fileHeap.at(i)->segment_id != -1)
+                evicted++;
+        cout << "--------------- TIER STATS ---------------" << endl;
+        cout << "Resident bytes: " << resident_bytes << ", Budget: " << memory_budget << endl;
+        cout << "Files resident: " << fileHeap.size() - evicted << ", Files on disk: " << evicted << endl;
+        cout << "Hits: " << tier_hits << ", Misses: " << tier_misses
+             << ", Hit rate: " << (total ? 100.0 * tier_hits / total : 0.0) << "%" << endl;
+        cout << "p99 hot command: " << hot_latency_ns.p99() << " ns, p99 cold command: "
+             << cold_latency_ns.p99() << " ns" << endl;
+        cout << "------------------------------------------" << endl;
+    }
 };
 
 bool is_valid_Command(const string &s)
@@ -665,6 +1646,21 @@ bool is_valid_Command(const string &s)
     return false;
 }
 
+// Parses a non-negative decimal count; rejects signs, junk and overflow.
+bool parse_count(const string &s, long long &out)
+{
+    if (s.empty() || s.size() > 18)
+        return false;
+    out = 0;
+    for (char c : s)
+    {
+        if (!isdigit((unsigned char)c))
+            return false;
+        out = out * 10 + (c - '0');
+    }
+    return true;
+}
+
 int main()
 {
     FileSystem fs;
@@ -676,6 +1672,7 @@ int main()
         istringstream iss(line);
         string token;
         iss >> token;
+        fs.beginCommand();
 
         if (token == "CREATE")
         {
@@ -686,9 +1683,54 @@ int main()
 
         else if (token == "READ")
         {
-            string fname;
+            string fname, first, second;
             iss >> fname;
-            fs.read(fname);
+            if (!(iss >> first) || is_valid_Command(first))
+                fs.read(fname);
+            else
+            {
+                long long offset, len;
+                if (iss >> second && parse_count(first, offset) && parse_count(second, len))
+                    fs.readRange(fname, offset, len);
+                else
+                    cout << "Invalid range for READ: expected <offset> <length>" << endl;
+            }
+        }
+
+        // Length-prefixed payload : exactly <len> raw bytes follow the command line.
+        else if (token == "INSERT_BIN" || token == "UPDATE_BIN")
+        {
+            string fname, count;
+            long long len = 0;
+            iss >> fname >> count;
+            string payload;
+            if (count.empty())
+                cout << "Missing payload length for " << token << endl;
+            else if (!parse_count(count, len))
+                cout << "Invalid payload length for " << token << ": " << count << endl;
+            else
+            {
+                // The buffer only grows as bytes actually arrive, so a bogus length
+                // ends in "Truncated payload" rather than a huge allocation.
+                while ((long long)payload.size() < len)
+                {
+                    size_t old = payload.size();
+                    size_t n = min((long long)IO_CHUNK, len - (long long)old);
+                    payload.resize(old + n);
+                    cin.read(&payload[old], n);
+                    if ((size_t)cin.gcount() != n)
+                    {
+                        payload.resize(old + cin.gcount());
+                        break;
+                    }
+                }
+                if ((long long)payload.size() != len)
+                    cout << "Truncated payload for " << fname << endl; // input is exhausted, so the loop ends
+                else if (token == "INSERT_BIN")
+                    fs.insert(fname, payload);
+                else
+                    fs.update(fname, payload);
+            }
         }
 
         else if (token == "INSERT" || token == "UPDATE" || token == "SNAPSHOT")
@@ -746,8 +1788,76 @@ int main()
             fs.printRecentFiles(n);
         }
 
+        else if (token == "MEMORY_BUDGET")
+        {
+            long long bytes = 0;
+            iss >> bytes;
+            fs.setMemoryBudget(bytes < 0 ? 0 : (size_t)bytes);
+        }
+
+        else if (token == "TIER_STATS")
+            fs.printTierStats();
+
+        else if (token == "EQUALS")
+        {
+            string fname;
+            int v1 = -1, v2 = -1;
+            iss >> fname >> v1 >> v2;
+            fs.equals(fname, v1, v2);
+        }
+
+        else if (token == "VERIFY")
+        {
+            string fname;
+            if (iss >> fname && !is_valid_Command(fname))
+                fs.verify(fname);
+            else
+                fs.verifyAll();
+        }
+
+        else if (token == "IMPORT")
+        {
+            string dir;
+            iss >> dir;
+            fs.importDirectory(dir);
+        }
+
+        else if (token == "IMPORT_STREAM")
+        {
+            string path;
+            iss >> path;
+            fs.importStream(path);
+        }
+
+        else if (token == "BEGIN")
+            fs.begin();
+
+        else if (token == "COMMIT")
+        {
+            string msg, word;
+            while (iss >> word)
+            {
+                if (!msg.empty())
+                    msg += " ";
+                msg += word;
+            }
+            fs.commit(msg.empty() ? "Transaction commit" : msg);
+        }
+
+        else if (token == "ABORT")
+            fs.abort();
+
+        else if (token == "ELIDE_NOOP")
+        {
+            string mode;
+            iss >> mode;
+            fs.setElideNoopUpdates(mode == "ON");
+        }
+
         else
             cout << "Unknown command: " << token << endl;
+
+        fs.endCommand();
     }
     return 0;
 }
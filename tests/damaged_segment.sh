@@ -0,0 +1,32 @@
+#!/bin/sh
+# Evicts a file, damages its segment on disk, and checks that VERIFY and
+# fault-in report the damage instead of crashing.
+# Usage: tests/damaged_segment.sh ./LongAssignment | diff - tests/damaged_segment.expected
+set -e
+bin=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+mkfifo in
+"$bin" < in > out &
+pid=$!
+exec 3> in
+
+# Segment layout for "a" (evicted first, so it starts at offset 0) :
+#   header 8 bytes, version 0 = 71 bytes, version 1 starts at 79 with its
+#   content length at 103 and its content at 111.
+printf 'CREATE a\nUPDATE a hello world\nCREATE b\nMEMORY_BUDGET 1\nVERIFY a\n' >&3
+sleep 0.5
+seg=$(ls -d tfs_segments.*)/seg_0.bin
+
+# Flip one content byte : the fingerprint no longer matches.
+printf 'j' | dd of="$seg" bs=1 seek=111 conv=notrunc 2>/dev/null
+printf 'VERIFY a\n' >&3
+sleep 0.5
+
+# Damage the content length : the segment can no longer be parsed.
+printf '\177' | dd of="$seg" bs=1 seek=110 conv=notrunc 2>/dev/null
+printf 'VERIFY a\nREAD a\nREAD b\nVERIFY b\n' >&3
+exec 3>&-
+wait $pid
+cat out